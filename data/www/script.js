@@ -4,6 +4,8 @@ const lblCapacity = document.getElementById('capacity')
 const lblVoltage = document.getElementById('voltage')
 const lblSpeed = document.getElementById('speed')
 const btnChangeDirection = document.getElementById('buttonChangeDirection')
+const lblUpdate = document.getElementById('update')
+const divUpdate = document.getElementById('updateblock')
 
 let ws
 window.addEventListener('load', onLoad);
@@ -60,6 +62,17 @@ function updateBattery(voltage) {
   lblVoltage.textContent = voltage
 }
 
+function updateProgress(progress, error) {
+  divUpdate.style.display = ""
+  if (progress < 0) {
+    lblUpdate.textContent = `fehlgeschlagen (${error})`
+  } else if (progress === 100) {
+    lblUpdate.textContent = 'OK, Neustart ...'
+  } else {
+    lblUpdate.textContent = `${progress} %`
+  }
+}
+
 function onMessage(event) {
   const data = event.data.split(":");
   const cmd = data[0];
@@ -67,6 +80,8 @@ function onMessage(event) {
     updateDirectionSpeed(Number.parseInt(data[1]), Number.parseInt(data[2]))
   } else if (cmd === 'B') {
     updateBattery(data[1])
+  } else if (cmd === 'U') {
+    updateProgress(Number.parseInt(data[1]), data[2])
   } else if (cmd === 'I') {
     console.log('Info:', data)
   }
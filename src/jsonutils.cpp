@@ -27,7 +27,7 @@ microrail.hdecloud.de
  * @return Config-Struktur
  *
  */
-Config json2Config(StaticJsonDocument<350>& jsonCfg){
+Config json2Config(StaticJsonDocument<512>& jsonCfg){
   Config config;
   config.name = jsonCfg[CFG_NAME].as<const char*>();
   config.wlan_ssid = jsonCfg[CFG_WLAN_SSID].as<const char*>();
@@ -37,6 +37,7 @@ Config json2Config(StaticJsonDocument<350>& jsonCfg){
   config.motor_inertia = jsonCfg[CFG_MOTOR_INERTIA].as<unsigned int>();
   config.motor_speed_step = jsonCfg[CFG_MOTOR_SPEED_STEP].as<unsigned int>();
   config.motor_reverse = jsonCfg[CFG_MOTOR_REVERSE].as<unsigned int>();
+  config.update_password = jsonCfg[CFG_UPDATE_PASSWORD] | "";
   return config;
 }
 
@@ -44,8 +45,8 @@ Config json2Config(StaticJsonDocument<350>& jsonCfg){
  * Konvertiert eine Config-Struktur in einen JSON-Dokument.
  * Validierung wird durchgeführt
  */
-StaticJsonDocument<350> config2Json(Config& config){
-  StaticJsonDocument<350> newConfig;
+StaticJsonDocument<512> config2Json(Config& config){
+  StaticJsonDocument<512> newConfig;
 
   newConfig[CFG_MOTOR_REVERSE] = config.motor_reverse;
 
@@ -81,6 +82,7 @@ StaticJsonDocument<350> config2Json(Config& config){
   newConfig[CFG_WLAN_SSID] = config.wlan_ssid;
   newConfig[CFG_WLAN_PASSWORD] = config.wlan_password;
   newConfig[CFG_NAME] = config.name;
+  newConfig[CFG_UPDATE_PASSWORD] = config.update_password;
 
   return newConfig;
 }
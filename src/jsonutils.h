@@ -26,9 +26,10 @@ microrail.hdecloud.de
 #define CFG_MOTOR_SPEED_STEP "motor_speed_step"
 #define CFG_MOTOR_INERTIA "motor_inertia"
 #define CFG_MOTOR_REVERSE "motor_reverse"
+#define CFG_UPDATE_PASSWORD "update_password"
 
-Config json2Config(StaticJsonDocument<350>& json);
+Config json2Config(StaticJsonDocument<512>& json);
 
-StaticJsonDocument<350> config2Json(Config& config);
+StaticJsonDocument<512> config2Json(Config& config);
 
 #endif
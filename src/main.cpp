@@ -30,12 +30,14 @@ microrail.hdecloud.de
 #include <LITTLEFS.h>
 #include <ArduinoJson.h>
 #include <LOLIN_I2C_MOTOR.h>
-#include <ticker.h>
+#include <EEPROM.h>
 #include <RunningMedian.h>
 #include "version.h"
 #include "wlanutils.h"
 #include "types.h"
 #include "jsonutils.h"
+#include "scheduler.h"
+#include "updatestream.h"
 
 #ifdef  LOCAL_DEBUG
 #include "localconfig.h"
@@ -45,6 +47,9 @@ microrail.hdecloud.de
 #define dir_backward 1
 #define LED_STATUS D6
 #define LED_ONBOARD D4
+#define CONFIG_BACKUP_MAGIC 0x4D52   // Kennung der Konfigurations-Sicherung im EEPROM
+#define CONFIG_BACKUP_SIZE 512
+#define UPDATE_USER "admin"          // Benutzer für Updates über WLAN
 
 // ----------------------------------------------------------------------------
 // Definition of global variables
@@ -62,11 +67,19 @@ LOLIN_I2C_MOTOR motor;
 
 void motionControl();
 void checkPower();
+void flushTelemetry();
+void notifyClients();
+void cleanupClients();
+void wifiControl();
 
-// Timer regelt alle x ms die Motorgeschwindigkeit
-Ticker motionControlTicker(motionControl, 200, 0, MILLIS);
-// Timer fragt alle 60 Sekunden den Akku-Status ab
-Ticker powerCheckTicker(checkPower, 60000, 0, MILLIS);
+// Scheduler für die periodischen Aufgaben der Hauptschleife
+Scheduler scheduler;
+int motionTask = -1;       // regelt die Geschwindigkeit, nur solange sie sich ändert
+int telemetryTask = -1;    // sendet den Status, nur nach notifyClients()
+
+// Update von Firmware und Filesystem über HTTP
+FlashUpdateTarget flashTarget;
+UpdateStream updateStream(flashTarget);
 
 // Speicher zur Berechnung der Durchschnittswerte bei der Akkuprüfung
 RunningMedian median1 = RunningMedian(10);
@@ -75,6 +88,10 @@ RunningMedian median1 = RunningMedian(10);
 int direction = dir_forward;   // Richtung 0: vorwärts, 1: rückwärts
 int actual_speed = 0;          // aktuelle Geschwindigkeit 0 - 100
 int target_speed = 0;          // Zielgeschwindigkeit
+volatile bool update_running = false;     // Update läuft, Motor bleibt gestoppt
+volatile bool restart_pending = false;    // Neustart nach erfolgreichem Update
+int update_progress = -1;                 // zuletzt gemeldeter Fortschritt in %
+AsyncWebServerRequest *update_request = nullptr;  // Verbindung des laufenden Updates
 
 const char *configFilename = "/config.json";  // Filename in Filesystem (LittleFS)
 String appVersionString = "MicroRail R v" + appVersion;
@@ -121,6 +138,60 @@ void initLittleFS() {
   Serial.println("- init LittleFS : OK");
 }
 
+/**
+ * Konfiguration 'config.json' im EEPROM sichern. Der EEPROM-Sektor liegt
+ * außerhalb des Filesystems und übersteht ein Filesystem-Update.
+ */
+bool saveConfigBackup() {
+  File configFile = LittleFS.open(configFilename, "r");
+  if (!configFile) {
+    return false;
+  }
+  size_t len = configFile.size();
+  if (len == 0 || len > CONFIG_BACKUP_SIZE - 4) {
+    configFile.close();
+    return false;
+  }
+  EEPROM.begin(CONFIG_BACKUP_SIZE);
+  EEPROM.put(0, (uint16_t)CONFIG_BACKUP_MAGIC);
+  EEPROM.put(2, (uint16_t)len);
+  for (size_t i = 0; i < len; i++) {
+    EEPROM.write(4 + i, configFile.read());
+  }
+  configFile.close();
+  bool ok = EEPROM.commit();
+  EEPROM.end();
+  return ok;
+}
+
+void clearConfigBackup() {
+  EEPROM.begin(CONFIG_BACKUP_SIZE);
+  EEPROM.put(0, (uint16_t)0);
+  EEPROM.commit();
+  EEPROM.end();
+}
+
+/**
+ * Nach einem Filesystem-Update die gesicherte Konfiguration zurückschreiben
+ */
+void restoreConfigBackup() {
+  uint16_t magic = 0, len = 0;
+  EEPROM.begin(CONFIG_BACKUP_SIZE);
+  EEPROM.get(0, magic);
+  EEPROM.get(2, len);
+  if (magic == CONFIG_BACKUP_MAGIC && len > 0 && len <= CONFIG_BACKUP_SIZE - 4) {
+    File configFile = LittleFS.open(configFilename, "w");
+    for (size_t i = 0; i < len; i++) {
+      configFile.write(EEPROM.read(4 + i));
+    }
+    configFile.close();
+    EEPROM.put(0, (uint16_t)0);
+    EEPROM.commit();
+    Serial.println("- restore Configuration : OK");
+  }
+  EEPROM.end();
+}
+
 /**
  * Konfiguration 'config.json' aus dem FS lesen
  */
@@ -133,7 +204,7 @@ void initConfiguration(Config& config) {
       onboard_led.update();
     }
   }
-  StaticJsonDocument<350> jsonCfg;
+  StaticJsonDocument<512> jsonCfg;
   deserializeJson(jsonCfg, configFile);
   configFile.close();
   config = json2Config(jsonCfg);
@@ -143,8 +214,11 @@ void initConfiguration(Config& config) {
 
 void initWiFi() {
 #ifdef LOCAL_DEBUG
-  setupWiFiSTA(ssidSTA, passwordSTA);  // WiFi Verbindung mit bestehendem WLAN aufbauen
-  config.ip_address = WiFi.localIP().toString();
+#ifdef STA_STATIC_IP
+  setStaticIpSTA(ipSTA, gatewaySTA, subnetSTA, dnsSTA);
+#endif
+  // WiFi Verbindung mit bestehendem WLAN aufbauen, Fallback eigenes WLAN
+  setupWiFiSTA(ssidSTA, passwordSTA, config.wlan_ssid.c_str(), config.wlan_password.c_str());
 #else
   const char* wlan_ssid = config.wlan_ssid.c_str();
   const char* wlan_password = config.wlan_password.c_str();
@@ -158,6 +232,119 @@ void initWiFi() {
 // Web server initialization
 // ----------------------------------------------------------------------------
 
+// ----------------------------------------------------------------------------
+// Firmware and filesystem update
+// ----------------------------------------------------------------------------
+
+/**
+ * Motor anhalten und Steuerung sperren, solange das Update läuft
+ */
+void stopMotorForUpdate() {
+  update_running = true;
+  target_speed = 0;
+  actual_speed = 0;
+  motor.changeDuty(MOTOR_CH_BOTH, 0.0);
+  notifyClients();
+}
+
+/**
+ * Nach einem fehlgeschlagenen Update Steuerung wieder freigeben
+ */
+void resumeAfterUpdate() {
+  ws.printfAll("U:-1:%s", updateStream.error());
+  Serial.printf("Update failed: %s\n", updateStream.error());
+  update_running = false;
+}
+
+void notifyUpdateProgress() {
+  int progress = updateStream.progress();
+  if (progress != update_progress) {
+    update_progress = progress;
+    ws.printfAll("U:%d", progress);
+  }
+}
+
+/**
+ * Updates nur mit konfiguriertem Passwort (Basic-Auth) zulassen
+ */
+bool updateAuthorized(AsyncWebServerRequest *request) {
+  return !config.update_password.isEmpty()
+    && request->authenticate(UPDATE_USER, config.update_password.c_str());
+}
+
+/**
+ * Parameter eines Updates prüfen, liefert eine Fehlermeldung oder nullptr
+ */
+const char* checkUpdateParams(AsyncWebServerRequest *request, UpdateType& type, String& md5) {
+  String typeParam = request->hasParam("type") ? request->getParam("type")->value() : "firmware";
+  md5 = request->hasParam("md5") ? request->getParam("md5")->value() : "";
+  if (typeParam != "firmware" && typeParam != "fs") {
+    return "invalid type";
+  }
+  if (!UpdateStream::validDigest(md5.c_str())) {
+    return "invalid md5";
+  }
+  type = typeParam == "fs" ? UPDATE_FILESYSTEM : UPDATE_FIRMWARE;
+  return nullptr;
+}
+
+/**
+ * Upload-Handler: schreibt das Image blockweise in den Flash.
+ * Parameter: md5 (Pflicht), type=fs für ein Filesystem-Image
+ */
+void handleUpdateUpload(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
+  if (index == 0) {
+    // läuft bereits ein Update oder ist die Anfrage ungültig, wird der Upload
+    // verworfen und der Motor nicht angehalten (Antwort siehe /update)
+    UpdateType type;
+    String md5;
+    if (update_running || !updateAuthorized(request) || checkUpdateParams(request, type, md5) != nullptr) {
+      return;
+    }
+    update_request = request;
+
+    Serial.printf("Update start: [%s], %u bytes\n", filename.c_str(), request->contentLength());
+    stopMotorForUpdate();
+    update_progress = -1;
+    request->onDisconnect([]() {
+      if (updateStream.state() == UPDATE_RUNNING) {
+        updateStream.abort("connection lost");
+        resumeAfterUpdate();
+      }
+      update_request = nullptr;
+    });
+    if (!updateStream.begin(type, md5.c_str(), request->contentLength())) {
+      resumeAfterUpdate();
+      return;
+    }
+  }
+
+  if (request != update_request || updateStream.state() != UPDATE_RUNNING) {
+    return;
+  }
+  if (len > 0 && !updateStream.write(index, data, len)) {
+    resumeAfterUpdate();
+    return;
+  }
+  if (final) {
+    // Konfiguration sichern, bevor das Filesystem-Image aktiviert wird
+    if (updateStream.type() == UPDATE_FILESYSTEM && !saveConfigBackup()) {
+      updateStream.abort("cannot save configuration");
+      resumeAfterUpdate();
+      return;
+    }
+    if (!updateStream.end()) {
+      clearConfigBackup();
+      resumeAfterUpdate();
+      return;
+    }
+    Serial.printf("Update finished: %u bytes\n", updateStream.written());
+    // Neustart auch dann, wenn der Client die Antwort nicht mehr abwartet
+    restart_pending = true;
+  }
+  notifyUpdateProgress();
+}
+
 String processor(const String& var) {
   if(var == "SSID") {
     return config.wlan_ssid;
@@ -183,22 +370,50 @@ String processor(const String& var) {
 }
 
 void initWebServer() {
-  server.serveStatic("/", LittleFS, "/");
+  // nur Web-Dateien ausliefern, config.json (Passwörter) liegt außerhalb von /www.
+  // LittleFS löst '..' auf, solche Pfade würden aus /www herausführen
+  server.serveStatic("/", LittleFS, "/www/").setFilter([](AsyncWebServerRequest *request){
+    return request->url().indexOf("..") < 0;
+  });
 
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
-    request->send(LittleFS, "/index.html", "text/html", false, processor);
+    request->send(LittleFS, "/www/index.html", "text/html", false, processor);
   });
 
   server.on("/favicon.ico", HTTP_GET, [](AsyncWebServerRequest *request){
-    request->send(LittleFS, "/chip.png", "image/png");
+    request->send(LittleFS, "/www/chip.png", "image/png");
   });
 
   server.on("/heap", HTTP_GET, [](AsyncWebServerRequest *request){
     request->send(200, "text/plain", String(ESP.getFreeHeap()));
   });
 
+  server.on("/tasks", HTTP_GET, [](AsyncWebServerRequest *request){
+    request->send(200, "text/plain", scheduler.stats());
+  });
+
+  server.on("/update", HTTP_POST, [](AsyncWebServerRequest *request){
+    UpdateType type;
+    String md5;
+    const char* error = nullptr;
+    if (config.update_password.isEmpty()) {
+      request->send(403, "text/plain", "update disabled");
+    } else if (!updateAuthorized(request)) {
+      request->requestAuthentication();
+    } else if (request == update_request) {
+      bool ok = updateStream.state() == UPDATE_SUCCEEDED;
+      request->send(ok ? 200 : 500, "text/plain", ok ? "OK" : updateStream.error());
+    } else if (update_running) {
+      request->send(409, "text/plain", "update already running");
+    } else if ((error = checkUpdateParams(request, type, md5)) != nullptr) {
+      request->send(400, "text/plain", error);
+    } else {
+      request->send(400, "text/plain", "no update data");
+    }
+  }, handleUpdateUpload);
+
   server.on("/setup", HTTP_GET, [](AsyncWebServerRequest *request){
-    request->send(LittleFS, "/setup.html", "text/html", false, processor);
+    request->send(LittleFS, "/www/setup.html", "text/html", false, processor);
   });
 
   server.on("/setup", HTTP_POST, [](AsyncWebServerRequest *request){
@@ -213,6 +428,18 @@ void initWebServer() {
     newConfig.motor_speed_step = request->getParam("motor-speedstep", true)->value().toInt();
     newConfig.motor_inertia = request->getParam("motor-inertia", true)->value().toInt();
     newConfig.motor_reverse = request->hasParam("motor-reverse", true) ? 1 : 0;
+    // Update-Passwort wird nie angezeigt, leer: unverändert.
+    // Ein gesetztes Passwort kann nur mit dem bisherigen geändert werden.
+    newConfig.update_password = config.update_password;
+    String updatePassword = request->hasParam("update-password", true) ? request->getParam("update-password", true)->value() : "";
+    String updatePasswordOld = request->hasParam("update-password-old", true) ? request->getParam("update-password-old", true)->value() : "";
+    if (!updatePassword.isEmpty()) {
+      if (config.update_password.isEmpty() || updatePasswordOld == config.update_password) {
+        newConfig.update_password = updatePassword;
+      } else {
+        Serial.println("Update password not changed, old password does not match");
+      }
+    }
 
     String configFile;
     serializeJsonPretty(config2Json(newConfig), configFile);
@@ -221,7 +448,7 @@ void initWebServer() {
     file.print(configFile);
     file.close();
 
-    request->send(LittleFS, "/setupok.html");
+    request->send(LittleFS, "/www/setupok.html");
   });
 
   server.begin();
@@ -232,8 +459,11 @@ void initWebServer() {
 // WebSocket initialization
 // ----------------------------------------------------------------------------
 
+/**
+ * Status zum Senden vormerken, der Versand erfolgt gebündelt in flushTelemetry()
+ */
 void notifyClients() {
-  ws.printfAll("A:%d:%d", direction, actual_speed);
+  scheduler.trigger(telemetryTask);
 }
 
 void handleCommands(char* command) {
@@ -245,21 +475,27 @@ void handleCommands(char* command) {
   if (strcmp(command, "#INFO") == 0) {
     // #INFO
     ws.printfAll("I:%s:%s:%s", config.wlan_ssid.c_str(), config.name.c_str(), appVersion.c_str());
+  } else if (update_running) {
+    // während des Updates keine Fahrbefehle
+    return;
   } else if (strcmp(command, "#ST") == 0) {
     // #Stop
     target_speed = 0;
+    scheduler.trigger(motionTask);
   } else if (strcmp(command, "#SL") == 0) {
     // #Slower
     target_speed -= motor_speed_step;
     if (target_speed < 0) {
       target_speed = 0;
     }
+    scheduler.trigger(motionTask);
   } else if (strcmp(command, "#FA") == 0) {
     // #Faster
     target_speed += motor_speed_step;
     if (target_speed > 100) {
       target_speed = 100;
     }
+    scheduler.trigger(motionTask);
   } else if (strcmp(command, "#DI") == 0) {
     // Richtungswechsel nur bei Halt ChangeDirection
     if (actual_speed == 0) {
@@ -339,8 +575,9 @@ void initMotorShield() {
  *
  */
 void motionControl() {
-  if (actual_speed == target_speed) {
-    // nichts zu tun
+  if (update_running || actual_speed == target_speed) {
+    // nichts zu tun, bis zum nächsten Fahrbefehl abschalten
+    scheduler.setEnabled(motionTask, false);
     return;
   }
   Serial.println("motionControl");
@@ -383,6 +620,41 @@ void checkPower() {
   ws.printfAll("B:%0.1f", batVoltage);
 }
 
+/**
+ * @brief Sendet einen vorgemerkten Status an alle Clients.
+ *
+ */
+void flushTelemetry() {
+  scheduler.setEnabled(telemetryTask, false);
+  ws.printfAll("A:%d:%d", direction, actual_speed);
+}
+
+/**
+ * @brief Gibt Resourcen getrennter Websocket-Clients frei.
+ *
+ */
+void cleanupClients() {
+  ws.cleanupClients();
+}
+
+/**
+ * @brief Überwacht die WLAN-Verbindung im Station-Mode.
+ *
+ */
+void wifiControl() {
+  static WifiState lastState = WIFI_STA_IDLE;
+  WifiState state = updateWiFiSTA();
+  if (state == lastState) {
+    return;
+  }
+  lastState = state;
+  if (state == WIFI_STA_CONNECTED) {
+    config.ip_address = WiFi.localIP().toString();
+  } else if (state == WIFI_STA_FALLBACK_AP) {
+    config.ip_address = WiFi.softAPIP().toString();
+  }
+}
+
 /**
  * Setup-Routine des Microcontrollers
  * - Filesystem initialisieren und Konfiguration einlesen
@@ -405,17 +677,25 @@ void setup() {
   Serial.printf("\n- Init: %s\n", appVersionString.c_str());
 
   initLittleFS();
+  restoreConfigBackup();
   initConfiguration(config);
   initWiFi();
   initMotorShield();
   initWebSocket();
   initWebServer();
 
-  // Start Timer
-  motionControlTicker.interval(config.motor_inertia);
-  motionControlTicker.start();
-  powerCheckTicker.start();
-  Serial.println("- Timer started : OK");
+  // Tasks einplanen und Scheduler starten
+  // Fahr- und Statustask werden ereignisgesteuert per trigger() aktiviert,
+  // im Stillstand bleiben nur Akku-Prüfung und Client-Cleanup eingeplant
+  motionTask = scheduler.add("motion", motionControl, config.motor_inertia, false);
+  telemetryTask = scheduler.add("telemetry", flushTelemetry, 50, false);
+  scheduler.add("power", checkPower, 60000);      // Akku-Status alle 60 Sekunden
+  scheduler.add("cleanup", cleanupClients, 1000);
+#ifdef LOCAL_DEBUG
+  scheduler.add("wifi", wifiControl, 100);
+#endif
+  scheduler.start();
+  Serial.println("- Scheduler started : OK");
 
   Serial.println("- Setup completed");
   Serial.println("----------------------------------------------");
@@ -432,7 +712,11 @@ void setup() {
 // ----------------------------------------------------------------------------
 
 void loop() {
-  motionControlTicker.update();
-  powerCheckTicker.update();
-  ws.cleanupClients();
+  scheduler.run();
+
+  if (restart_pending) {
+    // Antwort und Websocket-Meldungen noch versenden
+    delay(500);
+    ESP.restart();
+  }
 }
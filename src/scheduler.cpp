@@ -0,0 +1,148 @@
+/*
+ __     __  _______   _______
+|  |   |  ||  ___   \|  _____|
+|  |___|  || |   |  || |____
+|   ___   || |   |  ||  ____|
+|  |   |  || |__ |  || |_____
+|__|   |__||_______/ |_______|
+
+microrail.hdecloud.de
+© Heiko Deserno, 9/2024
+
+*/
+
+#include <Arduino.h>
+#include <coredecls.h>
+#include "scheduler.h"
+
+Scheduler::Scheduler() : count(0), triggered(false) {
+}
+
+/**
+ * @brief Registriert eine periodische Task.
+ *
+ */
+int Scheduler::add(const char* name, TaskCallback callback, uint32_t interval_ms, bool enabled) {
+  if (count >= SCHEDULER_MAX_TASKS) {
+    Serial.printf("Scheduler: cannot add task [%s]\n", name);
+    return -1;
+  }
+  Task& task = tasks[count];
+  task.name = name;
+  task.callback = callback;
+  task.interval = interval_ms * 1000;
+  task.next_run = micros() + task.interval;
+  task.enabled = enabled;
+  task.runs = 0;
+  task.overruns = 0;
+  task.max_jitter = 0;
+  task.max_duration = 0;
+  return count++;
+}
+
+/**
+ * @brief Aktiviert eine inaktive Task und plant sie sofort ein. Weckt die
+ * Hauptschleife, falls sie gerade bis zur nächsten Deadline schläft.
+ *
+ */
+void Scheduler::trigger(int id) {
+  if (id < 0 || id >= count || tasks[id].enabled) {
+    return;
+  }
+  tasks[id].next_run = micros();
+  tasks[id].enabled = true;
+  triggered = true;
+  esp_schedule();
+}
+
+void Scheduler::setEnabled(int id, bool enabled) {
+  if (id < 0 || id >= count || tasks[id].enabled == enabled) {
+    return;
+  }
+  tasks[id].next_run = micros() + tasks[id].interval;
+  tasks[id].enabled = enabled;
+}
+
+/**
+ * @brief Plant alle Tasks ab dem aktuellen Zeitpunkt ein.
+ *
+ */
+void Scheduler::start() {
+  uint32_t now = micros();
+  for (uint8_t i = 0; i < count; i++) {
+    tasks[i].next_run = now + tasks[i].interval;
+  }
+}
+
+/**
+ * @brief Führt die Task mit der frühesten Deadline aus, sofern sie fällig ist.
+ * Ist keine Task fällig, wird bis zur nächsten Deadline geschlafen. esp_delay()
+ * gibt die CPU an das SDK ab, so dass im Station-Mode Modem-Sleep greift, und
+ * endet vorzeitig, wenn trigger() eine Task aktiviert.
+ *
+ */
+void Scheduler::run() {
+  Task* next = nullptr;
+  int32_t wait = SCHEDULER_MAX_IDLE * 1000;
+  uint32_t now = micros();
+  triggered = false;
+
+  for (uint8_t i = 0; i < count; i++) {
+    if (!tasks[i].enabled) {
+      continue;
+    }
+    int32_t remaining = (int32_t)(tasks[i].next_run - now);
+    if (remaining < wait) {
+      next = &tasks[i];
+      wait = remaining;
+    }
+  }
+
+  if (next != nullptr && wait <= 0) {
+    execute(*next, now);
+  } else if (wait >= 1000) {
+    esp_delay(wait / 1000, [this]() { return !triggered; });
+  } else {
+    yield();
+  }
+}
+
+void Scheduler::execute(Task& task, uint32_t now) {
+  uint32_t jitter = now - task.next_run;
+  if (jitter > task.max_jitter) {
+    task.max_jitter = jitter;
+  }
+
+  if (jitter >= task.interval) {
+    // Deadline verpasst: neu synchronisieren statt Aufrufe nachzuholen
+    task.overruns++;
+    task.next_run = now + task.interval;
+  } else {
+    // feste Taktung ohne Drift
+    task.next_run += task.interval;
+  }
+
+  task.callback();
+  task.runs++;
+
+  uint32_t duration = micros() - now;
+  if (duration > task.max_duration) {
+    task.max_duration = duration;
+  }
+}
+
+/**
+ * @brief Liefert die Statistik aller Tasks (eine Zeile je Task).
+ *
+ */
+String Scheduler::stats() {
+  String result;
+  char line[128];
+  for (uint8_t i = 0; i < count; i++) {
+    Task& task = tasks[i];
+    snprintf(line, sizeof(line), "%s: %s, interval %u ms, runs %u, overruns %u, jitter %u us, duration %u us\n",
+      task.name, task.enabled ? "on" : "off", task.interval / 1000, task.runs, task.overruns, task.max_jitter, task.max_duration);
+    result += line;
+  }
+  return result;
+}
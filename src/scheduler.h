@@ -0,0 +1,81 @@
+/*
+ __     __  _______   _______
+|  |   |  ||  ___   \|  _____|
+|  |___|  || |   |  || |____
+|   ___   || |   |  ||  ____|
+|  |   |  || |__ |  || |_____
+|__|   |__||_______/ |_______|
+
+microrail.hdecloud.de
+© Heiko Deserno, 9/2024
+
+*/
+
+/**
+ * Kooperativer Scheduler für periodische Aufgaben.
+ * Die Tasks werden nach Fälligkeit (Deadline) abgearbeitet. Ist keine Task
+ * fällig, gibt der Scheduler die CPU bis zur nächsten Deadline ab.
+ * Ereignisgesteuerte Tasks schalten sich ab, sobald nichts zu tun ist, und
+ * werden per trigger() wieder aktiviert.
+ */
+
+#ifndef scheduler_h
+#define scheduler_h
+
+#include <Arduino.h>
+
+#define SCHEDULER_MAX_TASKS 8
+#define SCHEDULER_MAX_IDLE 1000     // ms, max. Schlafdauer ohne aktive Task
+
+typedef void (*TaskCallback)();
+
+// ----------------------------------------------------------------------------
+// Definition of Task
+// ----------------------------------------------------------------------------
+
+struct Task {
+  const char*  name;
+  TaskCallback callback;
+  uint32_t     interval;      // Intervall in µs
+  uint32_t     next_run;      // Deadline in µs (micros())
+  bool         enabled;
+
+  // Statistik
+  uint32_t     runs;          // Anzahl Ausführungen
+  uint32_t     overruns;      // Deadline um mehr als ein Intervall verpasst
+  uint32_t     max_jitter;    // max. Verspätung gegenüber der Deadline in µs
+  uint32_t     max_duration;  // max. Laufzeit der Task in µs
+};
+
+class Scheduler {
+  public:
+    Scheduler();
+
+    // Task registrieren, liefert die Task-Id oder -1
+    int add(const char* name, TaskCallback callback, uint32_t interval_ms, bool enabled = true);
+
+    // Inaktive Task aktivieren und sofort ausführen, eine aktive Task
+    // behält ihre Deadline. Auch aus Callbacks des Webservers aufrufbar.
+    void trigger(int id);
+
+    // Task aktivieren (ab jetzt einplanen) oder abschalten
+    void setEnabled(int id, bool enabled);
+
+    // Alle Tasks ab jetzt einplanen
+    void start();
+
+    // Fällige Task ausführen bzw. bis zur nächsten Deadline schlafen
+    void run();
+
+    // Statistik der Tasks als Text
+    String stats();
+
+  private:
+    Task    tasks[SCHEDULER_MAX_TASKS];
+    uint8_t count;
+    volatile bool triggered;   // beendet den Leerlauf vorzeitig
+
+    void execute(Task& task, uint32_t now);
+};
+
+#endif
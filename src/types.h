@@ -33,6 +33,7 @@ struct Config {
   int motor_speed_step;
   int motor_inertia;
   bool motor_reverse;
+  String update_password;   // Passwort für Updates über WLAN, leer: keine Updates
   String ip_address;
   String mac_address;
 };
@@ -0,0 +1,185 @@
+/*
+ __     __  _______   _______
+|  |   |  ||  ___   \|  _____|
+|  |___|  || |   |  || |____
+|   ___   || |   |  ||  ____|
+|  |   |  || |__ |  || |_____
+|__|   |__||_______/ |_______|
+
+microrail.hdecloud.de
+© Heiko Deserno, 9/2024
+
+*/
+
+#include <ctype.h>
+#include <string.h>
+#include "updatestream.h"
+
+UpdateStream::UpdateStream(UpdateTarget& target)
+  : _target(target), _state(UPDATE_IDLE), _type(UPDATE_FIRMWARE), _size(0), _written(0), _error("no update data") {
+}
+
+/**
+ * @brief Startet ein Update. Ohne gültigen MD5-Digest wird nicht geschrieben,
+ * ein laufendes Update wird nicht unterbrochen.
+ *
+ */
+bool UpdateStream::begin(UpdateType type, const char* md5, size_t size) {
+  if (_state == UPDATE_RUNNING) {
+    return false;
+  }
+  _type = type;
+  _size = size;
+  _written = 0;
+  _error = "";
+
+  if (!validDigest(md5)) {
+    fail("invalid md5");
+    return false;
+  }
+
+  if (!_target.begin(type, md5)) {
+    fail("cannot begin update");
+    return false;
+  }
+  _state = UPDATE_RUNNING;
+  return true;
+}
+
+/**
+ * @brief Schreibt einen Block. Ein Block außerhalb der Reihenfolge
+ * oder ein unvollständiger Schreibvorgang bricht das Update ab.
+ *
+ */
+bool UpdateStream::write(size_t index, const uint8_t* data, size_t len) {
+  if (_state != UPDATE_RUNNING) {
+    return false;
+  }
+  if (index != _written) {
+    abort("chunk out of order");
+    return false;
+  }
+  if (_target.write(data, len) != len) {
+    abort("write failed");
+    return false;
+  }
+  _written += len;
+  return true;
+}
+
+/**
+ * @brief Schließt das Update ab, das Ziel prüft dabei den Digest.
+ *
+ */
+bool UpdateStream::end() {
+  if (_state != UPDATE_RUNNING) {
+    return false;
+  }
+  if (_written == 0) {
+    abort("empty image");
+    return false;
+  }
+  if (!_target.end()) {
+    fail("verification failed");
+    return false;
+  }
+  _state = UPDATE_SUCCEEDED;
+  return true;
+}
+
+void UpdateStream::abort(const char* reason) {
+  if (_state == UPDATE_RUNNING) {
+    _target.abort();
+  }
+  fail(reason);
+}
+
+int UpdateStream::progress() const {
+  if (_state == UPDATE_SUCCEEDED) {
+    return 100;
+  }
+  if (_size == 0) {
+    return 0;
+  }
+  size_t percent = _written * 100 / _size;
+  return percent > 99 ? 99 : (int)percent;
+}
+
+bool UpdateStream::validDigest(const char* md5) {
+  if (md5 == nullptr || strlen(md5) != 32) {
+    return false;
+  }
+  for (int i = 0; i < 32; i++) {
+    if (!isxdigit((unsigned char)md5[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void UpdateStream::fail(const char* reason) {
+  _state = UPDATE_FAILED;
+  _error = reason;
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <Updater.h>
+#include <flash_hal.h>
+
+/**
+ * @brief Bereitet den Updater vor. Firmware und Filesystem-Image werden in den
+ * freien Sketch-Bereich geschrieben und erst nach der MD5-Prüfung aktiviert.
+ *
+ */
+bool FlashUpdateTarget::begin(UpdateType type, const char* md5) {
+#ifndef ATOMIC_FS_UPDATE
+  // ohne ATOMIC_FS_UPDATE würde das laufende Filesystem direkt überschrieben
+  if (type == UPDATE_FILESYSTEM) {
+    Serial.println("Filesystem update requires ATOMIC_FS_UPDATE");
+    return false;
+  }
+#endif
+
+  size_t size;
+  int command;
+  if (type == UPDATE_FILESYSTEM) {
+    size = (size_t)FS_end - (size_t)FS_start;
+    command = U_FS;
+  } else {
+    size = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+    command = U_FLASH;
+  }
+
+  Update.runAsync(true);  // Aufruf aus dem Kontext des AsyncWebServers
+  if (!Update.begin(size, command) || !Update.setMD5(md5)) {
+    Update.printError(Serial);
+    return false;
+  }
+  return true;
+}
+
+size_t FlashUpdateTarget::write(const uint8_t* data, size_t len) {
+  size_t written = Update.write(const_cast<uint8_t*>(data), len);
+  if (written != len) {
+    Update.printError(Serial);
+  }
+  return written;
+}
+
+bool FlashUpdateTarget::end() {
+  // Größe ist vorab unbekannt, daher auch mit verbleibendem Platz abschließen
+  if (!Update.end(true)) {
+    Update.printError(Serial);
+    return false;
+  }
+  return true;
+}
+
+void FlashUpdateTarget::abort() {
+  Update.end(false);
+  Update.clearError();
+}
+
+#endif
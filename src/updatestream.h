@@ -0,0 +1,118 @@
+/*
+ __     __  _______   _______
+|  |   |  ||  ___   \|  _____|
+|  |___|  || |   |  || |____
+|   ___   || |   |  ||  ____|
+|  |   |  || |__ |  || |_____
+|__|   |__||_______/ |_______|
+
+microrail.hdecloud.de
+© Heiko Deserno, 9/2024
+
+*/
+
+/**
+ * Update von Firmware und Filesystem.
+ * UpdateStream schreibt ein Image blockweise in ein UpdateTarget, ohne es im
+ * RAM zu puffern. Das Ziel prüft den MD5-Digest, bevor das Image aktiv wird.
+ * Filesystem-Images werden dazu mit ATOMIC_FS_UPDATE im freien Sketch-Bereich
+ * zwischengespeichert, das laufende LittleFS bleibt bis zum Neustart unberührt.
+ * Die Logik ist unabhängig vom Arduino-Framework, damit sie auch gegen ein
+ * dateibasiertes Ziel (native Build) laufen kann.
+ */
+
+#ifndef updatestream_h
+#define updatestream_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum UpdateType {
+  UPDATE_FIRMWARE,
+  UPDATE_FILESYSTEM
+};
+
+enum UpdateState {
+  UPDATE_IDLE,
+  UPDATE_RUNNING,
+  UPDATE_SUCCEEDED,
+  UPDATE_FAILED
+};
+
+// ----------------------------------------------------------------------------
+// Definition of UpdateTarget (Flash oder Stand-in)
+// ----------------------------------------------------------------------------
+
+class UpdateTarget {
+  public:
+    virtual ~UpdateTarget() {}
+
+    // Update vorbereiten, md5: erwarteter Digest (32 Hex-Zeichen)
+    virtual bool begin(UpdateType type, const char* md5) = 0;
+
+    // Block schreiben, liefert die Anzahl geschriebener Bytes
+    virtual size_t write(const uint8_t* data, size_t len) = 0;
+
+    // Digest prüfen und Image aktivieren
+    virtual bool end() = 0;
+
+    // Update abbrechen, bisheriges Image bleibt aktiv
+    virtual void abort() = 0;
+};
+
+class UpdateStream {
+  public:
+    UpdateStream(UpdateTarget& target);
+
+    // Update starten, size: erwartete Größe für die Fortschrittsanzeige (0: unbekannt)
+    // Liefert false, wenn bereits ein Update läuft
+    bool begin(UpdateType type, const char* md5, size_t size);
+
+    // Block an Position index schreiben, Blöcke müssen lückenlos folgen
+    bool write(size_t index, const uint8_t* data, size_t len);
+
+    // Update abschließen
+    bool end();
+
+    // Update abbrechen
+    void abort(const char* reason);
+
+    // Prüft einen MD5-Digest auf 32 Hex-Zeichen
+    static bool validDigest(const char* md5);
+
+    UpdateState state() const { return _state; }
+    UpdateType type() const { return _type; }
+    size_t written() const { return _written; }
+    const char* error() const { return _error; }
+
+    // Fortschritt in Prozent
+    int progress() const;
+
+  private:
+    UpdateTarget& _target;
+    UpdateState   _state;
+    UpdateType    _type;
+    size_t        _size;
+    size_t        _written;
+    const char*   _error;
+
+    void fail(const char* reason);
+};
+
+#ifdef ARDUINO
+
+// ----------------------------------------------------------------------------
+// Definition of FlashUpdateTarget (ESP8266 Updater)
+// ----------------------------------------------------------------------------
+
+class FlashUpdateTarget : public UpdateTarget {
+  public:
+    bool begin(UpdateType type, const char* md5) override;
+    size_t write(const uint8_t* data, size_t len) override;
+    bool end() override;
+    void abort() override;
+};
+
+#endif
+
+#endif
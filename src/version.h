@@ -17,4 +17,4 @@ microrail.hdecloud.de
  */
 
 // Hier version ändern, um die Softwareversion zu ändern
-String appVersion = "1.1.0";    // Software-Version
+String appVersion = "1.2.0";    // Software-Version
@@ -14,25 +14,179 @@ microrail.hdecloud.de
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
 #include <WiFiClient.h>
+#include <LITTLEFS.h>
+#include <ArduinoJson.h>
+#include "wlanutils.h"
+
+#define STA_CACHED_JOIN_TIMEOUT 3000    // ms, danach Verbindung mit Scan
+#define STA_JOIN_TIMEOUT 10000          // ms, danach neuer Verbindungsversuch
+#define STA_FALLBACK_TIMEOUT 20000      // ms, danach Accesspoint beim Start
+
+const char *wifiCacheFilename = "/wifi.json";  // Kanal und BSSID der letzten Verbindung
+
+// Kanal und BSSID des zuletzt verbundenen Accesspoints
+struct WifiCache {
+  bool    valid;
+  String  ssid;
+  int32_t channel;
+  uint8_t bssid[6];
+};
+
+static WifiCache cache = { false, "", 0, { 0 } };
+static WifiState state = WIFI_STA_IDLE;
+static String sta_ssid, sta_password;   // bestehendes WLAN
+static String ap_ssid, ap_password;     // eigenes WLAN als Fallback
+static bool was_connected = false;      // Fallback nur, wenn noch nie verbunden
+static bool using_cache = false;        // aktueller Versuch ohne Scan
+static unsigned long connect_start = 0; // Beginn des Verbindungsaufbaus
+static unsigned long join_start = 0;    // Beginn des aktuellen Versuchs
 
 /**
- * @brief Stellt WLAN-Verbindung zum bestehenden Netz her.
+ * @brief Liest Kanal und BSSID der letzten Verbindung aus dem FS.
  *
  */
-void setupWiFiSTA(const char* ssid, const char* password) {
-  WiFi.begin(ssid, password);
-  Serial.printf("Connecting to [%s] ...\n", ssid);
-
-  // Warteschleife bis Verbindung hergestellt ist
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(1000);
-    Serial.print(".");
+static void loadWifiCache() {
+  File file = LittleFS.open(wifiCacheFilename, "r");
+  if (!file) {
+    return;
+  }
+  StaticJsonDocument<128> json;
+  DeserializationError error = deserializeJson(json, file);
+  file.close();
+  if (error) {
+    return;
   }
+  cache.ssid = json["ssid"].as<const char*>();
+  cache.channel = json["channel"].as<int>();
+  const char* bssid = json["bssid"] | "";
+  cache.valid = cache.channel > 0 && sscanf(bssid, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+    &cache.bssid[0], &cache.bssid[1], &cache.bssid[2],
+    &cache.bssid[3], &cache.bssid[4], &cache.bssid[5]) == 6;
+}
+
+/**
+ * @brief Speichert Kanal und BSSID der aktuellen Verbindung, sofern geändert.
+ *
+ */
+static void saveWifiCache() {
+  int32_t channel = WiFi.channel();
+  uint8_t* bssid = WiFi.BSSID();
+  if (cache.valid && cache.ssid == sta_ssid && cache.channel == channel
+      && memcmp(cache.bssid, bssid, sizeof(cache.bssid)) == 0) {
+    return;
+  }
+  cache.valid = true;
+  cache.ssid = sta_ssid;
+  cache.channel = channel;
+  memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+
+  StaticJsonDocument<128> json;
+  json["ssid"] = cache.ssid;
+  json["channel"] = cache.channel;
+  json["bssid"] = WiFi.BSSIDstr();
+  File file = LittleFS.open(wifiCacheFilename, "w");
+  serializeJson(json, file);
+  file.close();
+  Serial.printf("Wifi cache saved, channel: [%d], BSSID: [%s]\n", channel, WiFi.BSSIDstr().c_str());
+}
+
+/**
+ * @brief Startet einen Verbindungsversuch. Mit gültigem Cache wird
+ * direkt auf Kanal und BSSID verbunden, ohne zu scannen.
+ *
+ */
+static void beginJoin() {
+  using_cache = cache.valid && cache.ssid == sta_ssid;
+  if (using_cache) {
+    WiFi.begin(sta_ssid.c_str(), sta_password.c_str(), cache.channel, cache.bssid, true);
+  } else {
+    WiFi.begin(sta_ssid.c_str(), sta_password.c_str());
+  }
+  join_start = millis();
+}
 
-  // Verbindungsdaten ausgeben
-  Serial.printf("Wifi connect to [%s], IP: [%s], MAC: [%s]\n", ssid,
-    WiFi.localIP().toString().c_str(), WiFi.macAddress().c_str());
-  Serial.printf("- init WiFi-STA: OK\n");
+/**
+ * @brief Legt eine feste IP-Adresse für den Station-Mode fest (spart DHCP).
+ *
+ */
+void setStaticIpSTA(IPAddress ip, IPAddress gateway, IPAddress subnet, IPAddress dns) {
+  WiFi.config(ip, gateway, subnet, dns);
+}
+
+/**
+ * @brief Startet die WLAN-Verbindung zum bestehenden Netz, ohne zu warten.
+ * Der Verbindungsaufbau erfolgt in updateWiFiSTA().
+ *
+ */
+void setupWiFiSTA(const char* ssid, const char* password, const char* fallback_ssid, const char* fallback_password) {
+  sta_ssid = ssid;
+  sta_password = password;
+  ap_ssid = fallback_ssid;
+  ap_password = fallback_password;
+
+  WiFi.persistent(false);       // keine Flash-Schreibzugriffe durch das SDK
+  WiFi.setAutoReconnect(false); // Reconnect erfolgt in updateWiFiSTA()
+  WiFi.mode(WIFI_STA);
+  loadWifiCache();
+
+  state = WIFI_STA_CONNECTING;
+  connect_start = millis();
+  beginJoin();
+  Serial.printf("Connecting to [%s]%s ...\n", ssid, using_cache ? " (cached)" : "");
+}
+
+/**
+ * @brief Zustandsautomat der WLAN-Verbindung, wird periodisch aufgerufen.
+ * - Verbindung hergestellt: Kanal und BSSID merken
+ * - Cache veraltet: Verbindung mit Scan
+ * - Verbindung verloren: neu verbinden
+ * - beim Start keine Verbindung: Accesspoint öffnen
+ *
+ */
+WifiState updateWiFiSTA() {
+  unsigned long now = millis();
+  wl_status_t status = WiFi.status();
+
+  switch (state) {
+    case WIFI_STA_CONNECTING:
+      if (status == WL_CONNECTED) {
+        state = WIFI_STA_CONNECTED;
+        was_connected = true;
+        Serial.printf("Wifi connect to [%s] in %lu ms, IP: [%s], MAC: [%s]\n", sta_ssid.c_str(), now - connect_start,
+          WiFi.localIP().toString().c_str(), WiFi.macAddress().c_str());
+        Serial.printf("- init WiFi-STA: OK\n");
+        saveWifiCache();
+      } else if (!was_connected && now - connect_start > STA_FALLBACK_TIMEOUT) {
+        Serial.printf("Wifi cannot connect to [%s]\n", sta_ssid.c_str());
+        WiFi.disconnect();
+        WiFi.mode(WIFI_AP);
+        setupWifiAP(ap_ssid.c_str(), ap_password.c_str());
+        state = WIFI_STA_FALLBACK_AP;
+      } else if (using_cache && (now - join_start > STA_CACHED_JOIN_TIMEOUT || status == WL_NO_SSID_AVAIL)) {
+        // Accesspoint nicht mehr auf Kanal/BSSID erreichbar
+        Serial.println("Wifi cache outdated, scanning ...");
+        cache.valid = false;
+        WiFi.disconnect();
+        beginJoin();
+      } else if (now - join_start > STA_JOIN_TIMEOUT || status == WL_NO_SSID_AVAIL || status == WL_CONNECT_FAILED) {
+        WiFi.disconnect();
+        beginJoin();
+      }
+      break;
+
+    case WIFI_STA_CONNECTED:
+      if (status != WL_CONNECTED) {
+        Serial.printf("Wifi connection to [%s] lost, reconnecting ...\n", sta_ssid.c_str());
+        state = WIFI_STA_CONNECTING;
+        connect_start = now;
+        beginJoin();
+      }
+      break;
+
+    default:
+      break;
+  }
+  return state;
 }
 
 /**
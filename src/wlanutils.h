@@ -18,8 +18,24 @@ microrail.hdecloud.de
 #ifndef wlanutils_h
 #define wlanutils_h
 
-// Initialisierung Station-Mode (bestehendes WLAN)
-void setupWiFiSTA(const char* ssid, const char* password);
+#include <ESP8266WiFi.h>
+
+// Zustand der Verbindung im Station-Mode
+enum WifiState {
+  WIFI_STA_IDLE,
+  WIFI_STA_CONNECTING,
+  WIFI_STA_CONNECTED,
+  WIFI_STA_FALLBACK_AP
+};
+
+// Optional: feste IP-Adresse im Station-Mode, vor setupWiFiSTA() aufrufen
+void setStaticIpSTA(IPAddress ip, IPAddress gateway, IPAddress subnet, IPAddress dns);
+
+// Initialisierung Station-Mode (bestehendes WLAN), nicht blockierend
+void setupWiFiSTA(const char* ssid, const char* password, const char* fallback_ssid, const char* fallback_password);
+
+// Verbindungsaufbau und Reconnect im Station-Mode, periodisch aufrufen
+WifiState updateWiFiSTA();
 
 // Initialisierung Accesspoint-Mode (eigenes WLAN)
 void setupWifiAP(const char* ssid, const char* password);
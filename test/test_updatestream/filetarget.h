@@ -0,0 +1,117 @@
+/*
+ __     __  _______   _______
+|  |   |  ||  ___   \|  _____|
+|  |___|  || |   |  || |____
+|   ___   || |   |  ||  ____|
+|  |   |  || |__ |  || |_____
+|__|   |__||_______/ |_______|
+
+microrail.hdecloud.de
+© Heiko Deserno, 9/2024
+
+*/
+
+/**
+ * Dateibasiertes UpdateTarget als Ersatz für den Flash (native Build).
+ * Wie der Updater mit ATOMIC_FS_UPDATE wird das Image zunächst in eine
+ * Staging-Datei geschrieben. Erst wenn deren MD5-Digest stimmt, ersetzt
+ * sie das bisherige Image, sonst bleibt dieses unverändert.
+ */
+
+#ifndef filetarget_h
+#define filetarget_h
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string>
+#include "updatestream.h"
+#include "md5.h"
+
+class FileUpdateTarget : public UpdateTarget {
+  public:
+    FileUpdateTarget(const char* filename)
+      : filename(filename), staging(std::string(filename) + ".staging"), file(nullptr),
+        max_write(0), begins(0), ends(0), aborts(0) {
+    }
+
+    bool begin(UpdateType type, const char* md5) override {
+      (void)type;
+      begins++;
+      expected = md5;
+      digest = Md5();
+      file = fopen(staging.c_str(), "wb");
+      return file != nullptr;
+    }
+
+    size_t write(const uint8_t* data, size_t len) override {
+      // max_write > 0 simuliert einen unvollständigen Schreibvorgang
+      size_t count = (max_write > 0 && len > max_write) ? max_write : len;
+      count = fwrite(data, 1, count, file);
+      digest.add(data, count);
+      return count;
+    }
+
+    bool end() override {
+      ends++;
+      fclose(file);
+      file = nullptr;
+
+      char actual[33];
+      digest.hexDigest(actual);
+      if (!sameDigest(actual, expected.c_str())) {
+        remove(staging.c_str());
+        return false;
+      }
+      return rename(staging.c_str(), filename) == 0;
+    }
+
+    void abort() override {
+      aborts++;
+      fclose(file);
+      file = nullptr;
+      remove(staging.c_str());
+    }
+
+    // Inhalt des aktiven Images lesen, liefert die Anzahl Bytes
+    size_t read(uint8_t* buffer, size_t size) {
+      FILE* in = fopen(filename, "rb");
+      if (in == nullptr) {
+        return 0;
+      }
+      size_t count = fread(buffer, 1, size, in);
+      fclose(in);
+      return count;
+    }
+
+    // Staging-Datei vorhanden?
+    bool staged() {
+      FILE* in = fopen(staging.c_str(), "rb");
+      if (in == nullptr) {
+        return false;
+      }
+      fclose(in);
+      return true;
+    }
+
+    const char* filename;
+    std::string staging;
+    std::string expected;
+    FILE*       file;
+    Md5         digest;
+    size_t      max_write;  // 0: unbegrenzt
+    int         begins;
+    int         ends;
+    int         aborts;
+
+  private:
+    static bool sameDigest(const char* a, const char* b) {
+      for (int i = 0; i < 32; i++) {
+        if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) {
+          return false;
+        }
+      }
+      return true;
+    }
+};
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ __     __  _______   _______
+|  |   |  ||  ___   \|  _____|
+|  |___|  || |   |  || |____
+|   ___   || |   |  ||  ____|
+|  |   |  || |__ |  || |_____
+|__|   |__||_______/ |_______|
+
+microrail.hdecloud.de
+© Heiko Deserno, 9/2024
+
+*/
+
+/**
+ * Tests der blockweisen Update-Logik gegen ein dateibasiertes Ziel.
+ * Ausführen mit: pio test -e native
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include "updatestream.h"
+#include "filetarget.h"
+
+#define IMAGE_FILE "test_updatestream.bin"
+#define IMAGE_MD5 "04efd1e6a4e06e3794694154279db582"   // MD5 von image
+#define WRONG_MD5 "0123456789abcdef0123456789ABCDEF"
+
+static uint8_t image[300];      // neues Image
+static uint8_t previous[200];   // bisheriges Image im "Flash"
+
+void setUp() {
+  for (size_t i = 0; i < sizeof(image); i++) {
+    image[i] = (uint8_t)(i * 7);
+  }
+  for (size_t i = 0; i < sizeof(previous); i++) {
+    previous[i] = (uint8_t)(i * 3 + 1);
+  }
+  FILE* out = fopen(IMAGE_FILE, "wb");
+  fwrite(previous, 1, sizeof(previous), out);
+  fclose(out);
+}
+
+void tearDown() {
+  remove(IMAGE_FILE);
+  remove(IMAGE_FILE ".staging");
+}
+
+// prüft, dass das bisherige Image unverändert aktiv ist
+static void assertPreviousImage(FileUpdateTarget& target) {
+  uint8_t flash[sizeof(image)];
+  TEST_ASSERT_EQUAL(sizeof(previous), target.read(flash, sizeof(flash)));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(previous, flash, sizeof(previous));
+  TEST_ASSERT_FALSE(target.staged());
+}
+
+void test_chunks_in_order() {
+  FileUpdateTarget target(IMAGE_FILE);
+  UpdateStream stream(target);
+
+  TEST_ASSERT_TRUE(stream.begin(UPDATE_FIRMWARE, IMAGE_MD5, sizeof(image)));
+  TEST_ASSERT_TRUE(stream.write(0, image, 100));
+  TEST_ASSERT_EQUAL(33, stream.progress());
+  TEST_ASSERT_TRUE(stream.write(100, image + 100, 100));
+  TEST_ASSERT_TRUE(stream.write(200, image + 200, 100));
+  TEST_ASSERT_EQUAL(99, stream.progress());
+  TEST_ASSERT_TRUE(stream.end());
+
+  TEST_ASSERT_EQUAL(UPDATE_SUCCEEDED, stream.state());
+  TEST_ASSERT_EQUAL(100, stream.progress());
+  TEST_ASSERT_EQUAL(sizeof(image), stream.written());
+  TEST_ASSERT_EQUAL(1, target.ends);
+  TEST_ASSERT_EQUAL(0, target.aborts);
+
+  uint8_t flash[sizeof(image) + 1];
+  TEST_ASSERT_EQUAL(sizeof(image), target.read(flash, sizeof(flash)));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(image, flash, sizeof(image));
+  TEST_ASSERT_FALSE(target.staged());
+}
+
+void test_out_of_order_chunk_aborts() {
+  FileUpdateTarget target(IMAGE_FILE);
+  UpdateStream stream(target);
+
+  TEST_ASSERT_TRUE(stream.begin(UPDATE_FIRMWARE, IMAGE_MD5, sizeof(image)));
+  TEST_ASSERT_TRUE(stream.write(0, image, 100));
+  TEST_ASSERT_FALSE(stream.write(200, image + 200, 100));
+
+  TEST_ASSERT_EQUAL(UPDATE_FAILED, stream.state());
+  TEST_ASSERT_EQUAL_STRING("chunk out of order", stream.error());
+  TEST_ASSERT_EQUAL(1, target.aborts);
+  TEST_ASSERT_FALSE(stream.write(100, image + 100, 100));
+  TEST_ASSERT_FALSE(stream.end());
+  TEST_ASSERT_EQUAL(0, target.ends);
+  assertPreviousImage(target);
+}
+
+void test_short_write_aborts() {
+  FileUpdateTarget target(IMAGE_FILE);
+  UpdateStream stream(target);
+  target.max_write = 50;
+
+  TEST_ASSERT_TRUE(stream.begin(UPDATE_FILESYSTEM, IMAGE_MD5, sizeof(image)));
+  TEST_ASSERT_FALSE(stream.write(0, image, 100));
+
+  TEST_ASSERT_EQUAL(UPDATE_FAILED, stream.state());
+  TEST_ASSERT_EQUAL_STRING("write failed", stream.error());
+  TEST_ASSERT_EQUAL(1, target.aborts);
+  TEST_ASSERT_EQUAL(0, stream.written());
+  assertPreviousImage(target);
+}
+
+void test_empty_image_aborts() {
+  FileUpdateTarget target(IMAGE_FILE);
+  UpdateStream stream(target);
+
+  TEST_ASSERT_TRUE(stream.begin(UPDATE_FIRMWARE, IMAGE_MD5, 0));
+  TEST_ASSERT_FALSE(stream.end());
+
+  TEST_ASSERT_EQUAL(UPDATE_FAILED, stream.state());
+  TEST_ASSERT_EQUAL_STRING("empty image", stream.error());
+  TEST_ASSERT_EQUAL(0, target.ends);
+  TEST_ASSERT_EQUAL(1, target.aborts);
+  assertPreviousImage(target);
+}
+
+void test_begin_while_running_is_rejected() {
+  FileUpdateTarget target(IMAGE_FILE);
+  UpdateStream stream(target);
+
+  TEST_ASSERT_TRUE(stream.begin(UPDATE_FIRMWARE, IMAGE_MD5, sizeof(image)));
+  TEST_ASSERT_TRUE(stream.write(0, image, 100));
+  TEST_ASSERT_FALSE(stream.begin(UPDATE_FILESYSTEM, WRONG_MD5, sizeof(image)));
+
+  // laufendes Update bleibt unverändert
+  TEST_ASSERT_EQUAL(UPDATE_RUNNING, stream.state());
+  TEST_ASSERT_EQUAL(UPDATE_FIRMWARE, stream.type());
+  TEST_ASSERT_EQUAL(1, target.begins);
+  TEST_ASSERT_EQUAL(0, target.aborts);
+  TEST_ASSERT_TRUE(stream.write(100, image + 100, 200));
+  TEST_ASSERT_TRUE(stream.end());
+}
+
+void test_invalid_md5_is_rejected() {
+  FileUpdateTarget target(IMAGE_FILE);
+  UpdateStream stream(target);
+
+  TEST_ASSERT_TRUE(UpdateStream::validDigest(IMAGE_MD5));
+  TEST_ASSERT_FALSE(UpdateStream::validDigest(""));
+  TEST_ASSERT_FALSE(UpdateStream::validDigest(IMAGE_MD5 "0"));
+
+  TEST_ASSERT_FALSE(stream.begin(UPDATE_FIRMWARE, "0123", sizeof(image)));
+  TEST_ASSERT_FALSE(stream.begin(UPDATE_FIRMWARE, "0123456789abcdef0123456789abcdeg", sizeof(image)));
+  TEST_ASSERT_FALSE(stream.begin(UPDATE_FIRMWARE, nullptr, sizeof(image)));
+
+  TEST_ASSERT_EQUAL(UPDATE_FAILED, stream.state());
+  TEST_ASSERT_EQUAL_STRING("invalid md5", stream.error());
+  TEST_ASSERT_EQUAL(0, target.begins);
+  assertPreviousImage(target);
+}
+
+void test_digest_mismatch_keeps_previous_image() {
+  FileUpdateTarget target(IMAGE_FILE);
+  UpdateStream stream(target);
+
+  TEST_ASSERT_TRUE(stream.begin(UPDATE_FIRMWARE, WRONG_MD5, sizeof(image)));
+  TEST_ASSERT_TRUE(stream.write(0, image, sizeof(image)));
+  TEST_ASSERT_FALSE(stream.end());
+
+  TEST_ASSERT_EQUAL(UPDATE_FAILED, stream.state());
+  TEST_ASSERT_EQUAL_STRING("verification failed", stream.error());
+  assertPreviousImage(target);
+}
+
+void test_truncated_image_fails_verification() {
+  FileUpdateTarget target(IMAGE_FILE);
+  UpdateStream stream(target);
+
+  // letzter Block fehlt, der Digest passt nicht zum übertragenen Teil
+  TEST_ASSERT_TRUE(stream.begin(UPDATE_FIRMWARE, IMAGE_MD5, sizeof(image)));
+  TEST_ASSERT_TRUE(stream.write(0, image, 200));
+  TEST_ASSERT_FALSE(stream.end());
+
+  TEST_ASSERT_EQUAL_STRING("verification failed", stream.error());
+  assertPreviousImage(target);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_chunks_in_order);
+  RUN_TEST(test_out_of_order_chunk_aborts);
+  RUN_TEST(test_short_write_aborts);
+  RUN_TEST(test_empty_image_aborts);
+  RUN_TEST(test_begin_while_running_is_rejected);
+  RUN_TEST(test_invalid_md5_is_rejected);
+  RUN_TEST(test_digest_mismatch_keeps_previous_image);
+  RUN_TEST(test_truncated_image_fails_verification);
+  return UNITY_END();
+}